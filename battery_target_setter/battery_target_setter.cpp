@@ -1,10 +1,13 @@
 #include <mlpack.hpp>
+#include <chrono>
 #include <iomanip>
 #include <mosquitto.h>
 #include <InfluxDB/InfluxDBFactory.h>
 
 #include "influx_tools.hpp"
 #include "print_dataset.hpp"
+#include "tree_ensemble.hpp"
+#include "hour_of_day_specialists.hpp"
 
 using namespace arma;
 using namespace mlpack;
@@ -17,8 +20,81 @@ void onPublish(struct mosquitto *mosq, void *obj, int mid);
 static bool mqttConnected;
 static bool mqttPublished;
 
-int main()
+int main(int argc, char** argv)
 {
+  // The pipeline works on a fixed step size, which defaults to 1 hour but can be
+  // set to any whole number of minutes that divides an hour with
+  // `--step-minutes N`.  When N is a multiple of 15 below 60, the 15-minute
+  // forecast and sun position measurements (suffixed "_15m") are used; these
+  // are only written when PULL_15_MINUTE is set in the Open-Meteo pull scripts
+  // (see openmeteo_15m.py) and compute_sun_positions.py has been rerun with a
+  // sub-hourly STEP_MINUTES.  Data at any other resolution is resampled onto
+  // the step grid.
+  //
+  // `--specialist-hours N` splits the day into blocks of N hours (N must divide
+  // 24) and trains a separate generation and usage model for each block.  The
+  // default of 24 is a single model for the whole day.
+  //
+  // `--trees N` sets the number of trees in each generation and usage forest.
+  // The trees are trained in parallel; the default of 0 means one tree per core,
+  // but at least TreeEnsemble::minimumDefaultTrees.
+  //
+  // `--compare-baseline` also trains the original single DecisionTreeRegressor
+  // on the generation data and prints its training time and RMSE next to the
+  // forest's, for tuning `--trees`.
+  size_t stepMinutes = 60;
+  size_t specialistHours = 24;
+  size_t numTrees = 0;
+  bool compareBaseline = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    const string arg(argv[i]);
+    if (arg == "--step-minutes" && i + 1 < argc)
+    {
+      stepMinutes = strtoul(argv[++i], NULL, 10);
+    }
+    else if (arg == "--specialist-hours" && i + 1 < argc)
+    {
+      specialistHours = strtoul(argv[++i], NULL, 10);
+    }
+    else if (arg == "--trees" && i + 1 < argc)
+    {
+      numTrees = strtoul(argv[++i], NULL, 10);
+    }
+    else if (arg == "--compare-baseline")
+    {
+      compareBaseline = true;
+    }
+    else
+    {
+      cerr << "Usage: " << argv[0] << " [--step-minutes N] "
+          << "[--specialist-hours N] [--trees N] [--compare-baseline]" << endl;
+      exit(1);
+    }
+  }
+
+  if (stepMinutes == 0 || 60 % stepMinutes != 0)
+  {
+    cerr << "Step size must be a nonzero number of minutes that divides 60!"
+        << endl;
+    exit(1);
+  }
+
+  if (specialistHours == 0 || 24 % specialistHours != 0)
+  {
+    cerr << "Specialist block size must be a nonzero number of hours that "
+        << "divides 24!" << endl;
+    exit(1);
+  }
+
+  // Every generation and usage model (or specialist sub-model) starts from this;
+  // HourOfDaySpecialists splits the cores between the sub-models.
+  const TreeEnsemble baseModel(numTrees);
+
+  const size_t step = 60 * stepMinutes; // In seconds.
+  const size_t stepsPerDay = 86400 / step;
+  const double stepHours = step / 3600.0;
+
   // Initialize libmosquitto for MQTT commands.
   if (mosquitto_lib_init() != MOSQ_ERR_SUCCESS)
   {
@@ -29,13 +105,18 @@ int main()
   unique_ptr<InfluxDB> influxdb = InfluxDBFactory::Get(
       "http://localhost:8086?db=weather");
 
-  // First get today's forecast; should be 24 points.
+  // Pick the weather measurements with the finest resolution that we can use.
+  const string suffix = (step < 3600 && step % 900 == 0) ? "_15m" : "";
+
+  // First get today's forecast; once resampled, this should be one day of
+  // points.
   InfluxDataset<float> dailyForecast = InfluxToArma(influxdb,
-      "SELECT * FROM daily_forecast", "daily forecast", 24);
+      "SELECT * FROM daily_forecast" + suffix, "daily forecast" + suffix);
+  const size_t dailyForecastStep = NativeStep(dailyForecast);
 
   // Now get all of our historical forecast data.
   InfluxDataset<float> forecastHistory = InfluxToArma(influxdb,
-      "SELECT * FROM forecast_history", "forecast history");
+      "SELECT * FROM forecast_history" + suffix, "forecast history" + suffix);
   // For some reason, this query picks up a column called 'date'.
   if (forecastHistory.colmap.count("date") > 0)
   {
@@ -56,7 +137,8 @@ int main()
     throw runtime_error(oss.str());
   }
 
-  if (dailyForecast.timestamps[0] - 3600 !=
+  const size_t forecastHistoryStep = NativeStep(forecastHistory);
+  if (dailyForecast.timestamps[0] - forecastHistoryStep !=
       forecastHistory.timestamps[forecastHistory.timestamps.n_elem - 1])
   {
     time_t t1 = forecastHistory.timestamps[
@@ -66,14 +148,26 @@ int main()
     oss << "Last timestamp of forecast history is "
         << put_time(localtime(&t1), "%c %Z") << ", but first timestamp of "
         << "daily forecast is " << put_time(localtime(&t2), "%c %Z")
-        << "; they should be separated by 1 hour only!";
+        << "; they should be separated by " << forecastHistoryStep
+        << " seconds only!";
     throw runtime_error(oss.str());
   }
 
-  // Historical data is the sum of what was observed at the end of the hour, but
-  // since we are taking it as a "forecast" for our training data, we need to
-  // shift the timestamp to refer to the start of the hour.
-  forecastHistory.timestamps -= 3600;
+  // Historical data is the sum of what was observed at the end of the interval,
+  // but since we are taking it as a "forecast" for our training data, we need to
+  // shift the timestamp to refer to the start of the interval.
+  forecastHistory.timestamps -= forecastHistoryStep;
+
+  // Now bring both forecasts to our step size.
+  forecastHistory = Resample(forecastHistory, step, forecastHistoryStep);
+  dailyForecast = Resample(dailyForecast, step, dailyForecastStep);
+  if (dailyForecast.timestamps.n_elem != stepsPerDay)
+  {
+    ostringstream oss;
+    oss << "Expected " << stepsPerDay << " points in daily forecast, but got "
+        << dailyForecast.timestamps.n_elem << "!";
+    throw runtime_error(oss.str());
+  }
 
   forecastHistory.timestamps.insert_rows(forecastHistory.timestamps.n_rows,
       dailyForecast.timestamps);
@@ -81,12 +175,12 @@ int main()
       dailyForecast.data);
 
   // Lastly, get sun azimuth and altitude data, but get it for 24 hours past the
-  // current time.  NOTE: on non-POSIX systems, the +3600 might not be valid.
+  // current time.  NOTE: on non-POSIX systems, the +86400 might not be valid.
   // But I only intend to run this on POSIX-compliant systems.
   time_t queryEnd = std::time(nullptr) + 86400;
   std::ostringstream altazQuery;
-  altazQuery << "SELECT * FROM sun_altaz WHERE time <= " << queryEnd
-      << "000000000";
+  altazQuery << "SELECT * FROM sun_altaz" << suffix << " WHERE time <= "
+      << queryEnd << "000000000";
   InfluxDataset<float> sunAltaz = InfluxToArma(influxdb, altazQuery.str(),
       "sun alt/az");
 
@@ -95,6 +189,8 @@ int main()
   // actually be the number of degrees we are off from due south.
   sunAltaz.data.row(sunAltaz.colmap["sun_az"]) =
       180.0 - abs(sunAltaz.data.row(sunAltaz.colmap["sun_az"]) - 180.0);
+  // (Unlike the raw azimuth, this is continuous, so it's safe to interpolate.)
+  sunAltaz = Resample(sunAltaz, step, NativeStep(sunAltaz));
 
   // Now pull historical data for the total time range.
 
@@ -103,9 +199,11 @@ int main()
   unique_ptr<InfluxDB> influxdbSolar = InfluxDBFactory::Get(
       "http://localhost:8086?db=solar_assistant");
 
+  std::ostringstream genQuery;
+  genQuery << "SELECT mean(combined) AS gen FROM \"PV power\" "
+      << "GROUP BY time(" << step << "s)";
   InfluxDataset<float> generationHistory = InfluxToArma(influxdbSolar,
-      "SELECT mean(combined) AS hourly_gen FROM \"PV power\" GROUP BY time(1h)",
-      "generation history");
+      genQuery.str(), "generation history");
   // Add zeros for the time we will predict.
   generationHistory.timestamps.insert_rows(generationHistory.timestamps.n_rows,
       dailyForecast.timestamps);
@@ -120,8 +218,8 @@ int main()
 
   // Generate historical generation features.
   frowvec lastDayGen(predictors.timestamps.n_elem);
-  lastDayGen.subvec(24, lastDayGen.n_elem - 1) = predictors.data.submat(0, 0,
-      0, predictors.data.n_cols - 25);
+  lastDayGen.subvec(stepsPerDay, lastDayGen.n_elem - 1) =
+      predictors.data.submat(0, 0, 0, predictors.data.n_cols - stepsPerDay - 1);
 
   predictors.data.insert_rows(predictors.data.n_rows, lastDayGen);
   predictors.names.push_back("gen_yesterday_this_time");
@@ -131,35 +229,54 @@ int main()
   // Sum each of the last seven days (or however many we have).
   for (size_t d = 0; d < 7; ++d)
   {
-    avgLastWeekGen.subvec(24 * (d + 1), lastDayGen.n_elem - 1) +=
+    avgLastWeekGen.subvec(stepsPerDay * (d + 1), lastDayGen.n_elem - 1) +=
         predictors.data.submat(0, 0, 0,
-                               predictors.data.n_cols - 1 - 24 * (d + 1));
+            predictors.data.n_cols - 1 - stepsPerDay * (d + 1));
   }
 
   for (size_t d = 2; d <= 7; ++d)
   {
-    avgLastWeekGen.subvec(24 * d,
-        (d < 7) ? (24 * (d + 1) - 1) : avgLastWeekGen.n_elem - 1) /= d;
+    avgLastWeekGen.subvec(stepsPerDay * d, (d < 7) ?
+        (stepsPerDay * (d + 1) - 1) : avgLastWeekGen.n_elem - 1) /= d;
   }
 
   predictors.data.insert_rows(predictors.data.n_rows, avgLastWeekGen);
   predictors.names.push_back("avg_gen_last_week_this_time");
   predictors.colmap["avg_gen_last_week_this_time"] = predictors.data.n_rows - 1;
 
-  // Compute recent cloud variance over the past day and three days.
-  frowvec cloudCoverVarianceYesterday(predictors.data.n_cols);
-  frowvec cloudCoverVariance3Days(predictors.data.n_cols);
-  for (size_t i = 48; i < 96; ++i)
+  // Compute recent cloud variance over the past day and three days.  We use
+  // running sums so that the cost of each window doesn't depend on its length
+  // (which grows with the number of steps per day).
+  vec cloudSums(predictors.data.n_cols + 1, fill::zeros);
+  vec cloudSqSums(predictors.data.n_cols + 1, fill::zeros);
+  for (size_t i = 0; i < predictors.data.n_cols; ++i)
   {
-    cloudCoverVarianceYesterday[i] = var(vectorise(
-        predictors.data.submat(1, i - 48, 1, i - 24)));
+    const double c = predictors.data(1, i);
+    cloudSums[i + 1] = cloudSums[i] + c;
+    cloudSqSums[i + 1] = cloudSqSums[i] + c * c;
   }
-  for (size_t i = 96; i < predictors.data.n_cols; ++i)
+
+  // Unbiased variance of the cloud cover in columns [first, last], matching
+  // var().
+  auto cloudCoverVariance = [&](const size_t first, const size_t last)
+  {
+    const double n = last - first + 1;
+    const double sum = cloudSums[last + 1] - cloudSums[first];
+    const double sqSum = cloudSqSums[last + 1] - cloudSqSums[first];
+    return std::max((sqSum - sum * sum / n) / (n - 1), 0.0);
+  };
+
+  frowvec cloudCoverVarianceYesterday(predictors.data.n_cols);
+  frowvec cloudCoverVariance3Days(predictors.data.n_cols);
+  for (size_t i = 2 * stepsPerDay; i < predictors.data.n_cols; ++i)
   {
-    cloudCoverVarianceYesterday[i] = var(vectorise(
-        predictors.data.submat(1, i - 48, 1, i - 24)));
-    cloudCoverVariance3Days[i] = var(vectorise(
-        predictors.data.submat(1, i - 96, 1, i - 24)));
+    cloudCoverVarianceYesterday[i] = cloudCoverVariance(i - 2 * stepsPerDay,
+        i - stepsPerDay);
+    if (i >= 4 * stepsPerDay)
+    {
+      cloudCoverVariance3Days[i] = cloudCoverVariance(i - 4 * stepsPerDay,
+          i - stepsPerDay);
+    }
   }
 
   predictors.data.insert_rows(predictors.data.n_rows, cloudCoverVarianceYesterday);
@@ -172,14 +289,16 @@ int main()
 
   // Print the dataset before we filter down to only rows that have any
   // generation at all, just so that it makes more sense to the reader.
-  PrintDataset(predictors);
+  PrintDataset(predictors, stepsPerDay);
 
   // Split off our test set.  Drop the first row too, since that's (zeroed)
   // generation data.
-  fmat genTest = predictors.data.submat(1, predictors.data.n_cols - 25,
-      predictors.data.n_rows - 1, predictors.data.n_cols - 1);
+  fmat genTest = predictors.data.submat(1,
+      predictors.data.n_cols - stepsPerDay, predictors.data.n_rows - 1,
+      predictors.data.n_cols - 1);
   uvec genTestTimes = predictors.timestamps.subvec(
-      predictors.timestamps.n_elem - 25, predictors.timestamps.n_elem - 1);
+      predictors.timestamps.n_elem - stepsPerDay,
+      predictors.timestamps.n_elem - 1);
 
   // This will filter out the data in the test set (since the prediction values
   // are set to zero).
@@ -199,16 +318,37 @@ int main()
   // can be worthwhile to divide generation and also radiation-related variables
   // by 'terrestrial_radiation', so really we are predicting
   // generation/irradiation.
-  mlpack::DecisionTreeRegressor genModel; // Step 1: create model.
-  genModel.Train(predictors.data, gen); // Step 2: train model.
+  // Step 1: create model.
+  HourOfDaySpecialists<> genModel(specialistHours, baseModel);
+  // Step 2: train model.
+  auto trainStart = chrono::steady_clock::now();
+  genModel.Train(predictors.data, gen, predictors.timestamps);
+  cout << "Trained generation model (" << baseModel.NumTrees() << " trees) in "
+      << chrono::duration<double>(chrono::steady_clock::now() -
+      trainStart).count() << "s." << endl;
   frowvec predictions;
   frowvec genTestPreds;
 
+  if (compareBaseline)
+  {
+    trainStart = chrono::steady_clock::now();
+    DecisionTreeRegressor baselineModel;
+    baselineModel.Train(predictors.data, gen);
+    const double baselineTime = chrono::duration<double>(
+        chrono::steady_clock::now() - trainStart).count();
+    frowvec baselinePreds;
+    baselineModel.Predict(predictors.data, baselinePreds);
+    cout << "Baseline single tree trained in " << baselineTime << "s; RMSE on "
+        << "the training set: " << sqrt(mean(pow(baselinePreds - gen, 2)))
+        << "." << endl;
+  }
+
   // Now compute the RMSE on the training set.
-  genModel.Predict(predictors.data, predictions);
-  genModel.Predict(genTest, genTestPreds);
+  genModel.Predict(predictors.data, predictors.timestamps, predictions);
+  genModel.Predict(genTest, genTestTimes, genTestPreds);
 
-  // Three different regimes: 0-500 Wh, 500-5000 Wh, and 5000+ Wh.
+  // Three different regimes of mean power over a step: 0-500 W, 500-5000 W,
+  // and 5000+ W.
 
   // TODO: really, we should compute these measures as part of k-fold
   // cross-validation.
@@ -221,20 +361,22 @@ int main()
   const size_t rmse500Count = accu(gen < 500.0);
   const size_t rmse5kCount = accu(gen >= 500.0 && gen < 5000.0);
   const size_t rmseMaxCount = accu(gen >= 5000.0);
-  cout << "RMSE on the training set <  500 Wh:            " << rmse500 << "." << std::endl;
-  cout << "RMSE on the training set >= 500 Wh, < 5000 Wh: " << rmse5k << "." << std::endl;
-  cout << "RMSE on the training set >= 5000 Wh:           " << rmseMax << "." << std::endl;
-  cout << "Training set points < 500 Wh: " << rmse500Count << "." << endl;
-  cout << "Training set points >= 500 Wh, < 5000 Wh: " << rmse5kCount << "." << endl;
-  cout << "Training set points >= 5000 Wh: " << rmseMaxCount << "." << endl;
+  cout << "RMSE on the training set <  500 W:           " << rmse500 << "." << std::endl;
+  cout << "RMSE on the training set >= 500 W, < 5000 W: " << rmse5k << "." << std::endl;
+  cout << "RMSE on the training set >= 5000 W:          " << rmseMax << "." << std::endl;
+  cout << "Training set points < 500 W: " << rmse500Count << "." << endl;
+  cout << "Training set points >= 500 W, < 5000 W: " << rmse5kCount << "." << endl;
+  cout << "Training set points >= 5000 W: " << rmseMaxCount << "." << endl;
 
   cout << "RMSE on the training set: "
       << sqrt(mean(pow(predictions - gen, 2))) << "." << std::endl;
 
   // Next, we need to collect data to build a model on power usage.
+  std::ostringstream usageQuery;
+  usageQuery << "SELECT mean(inverter_0) AS usage FROM "
+      << "\"Load power essential\" GROUP BY time(" << step << "s)";
   InfluxDataset<float> usageHistory = InfluxToArma(influxdbSolar,
-      "SELECT mean(inverter_0) AS hourly_usage FROM \"Load power essential\" GROUP BY time(1h)",
-      "usage history");
+      usageQuery.str(), "usage history");
 
   // We can just use the same features as for generation forecasting; many of
   // them won't be anywhere near as useful.
@@ -260,13 +402,15 @@ int main()
   usageFeatures.data.shed_row(0);
 
   // Build the model.
-  DecisionTreeRegressor usageModel;
-  usageModel.Train(usageFeatures.data, usages);
+  HourOfDaySpecialists<> usageModel(specialistHours, baseModel);
+  usageModel.Train(usageFeatures.data, usages, usageFeatures.timestamps);
 
   frowvec usagePreds;
   frowvec usageTestPreds;
-  usageModel.Predict(usageFeatures.data, usagePreds);
-  usageModel.Predict(dailyForecast.data, usageTestPreds);
+  usageModel.Predict(usageFeatures.data, usageFeatures.timestamps,
+      usagePreds);
+  usageModel.Predict(dailyForecast.data, dailyForecast.timestamps,
+      usageTestPreds);
 
   const double rmse500u = sqrt(accu((usages < 500.0) %
       pow(usagePreds - usages, 2)) / accu((usages < 500.0)));
@@ -274,27 +418,28 @@ int main()
       pow(usagePreds - usages, 2)) / accu((usages >= 500.0 && usages < 5000.0)));
   const double rmseMaxu = sqrt(accu((usages >= 5000.0) %
       pow(usagePreds - usages, 2)) / accu((usages >= 5000.0)));
-  const size_t rmse500Countu = accu(gen < 500.0);
-  const size_t rmse5kCountu = accu(gen >= 500.0 && gen < 5000.0);
-  const size_t rmseMaxCountu = accu(gen >= 5000.0);
-  cout << "RMSE on the training set <  500 Wh:            " << rmse500u << "." << std::endl;
-  cout << "RMSE on the training set >= 500 Wh, < 5000 Wh: " << rmse5ku << "." << std::endl;
-  cout << "RMSE on the training set >= 5000 Wh:           " << rmseMaxu << "." << std::endl;
-  cout << "Training set points < 500 Wh: " << rmse500Countu << "." << endl;
-  cout << "Training set points >= 500 Wh, < 5000 Wh: " << rmse5kCountu << "." << endl;
-  cout << "Training set points >= 5000 Wh: " << rmseMaxCountu << "." << endl;
+  const size_t rmse500Countu = accu(usages < 500.0);
+  const size_t rmse5kCountu = accu(usages >= 500.0 && usages < 5000.0);
+  const size_t rmseMaxCountu = accu(usages >= 5000.0);
+  cout << "RMSE on the training set <  500 W:           " << rmse500u << "." << std::endl;
+  cout << "RMSE on the training set >= 500 W, < 5000 W: " << rmse5ku << "." << std::endl;
+  cout << "RMSE on the training set >= 5000 W:          " << rmseMaxu << "." << std::endl;
+  cout << "Training set points < 500 W: " << rmse500Countu << "." << endl;
+  cout << "Training set points >= 500 W, < 5000 W: " << rmse5kCountu << "." << endl;
+  cout << "Training set points >= 5000 W: " << rmseMaxCountu << "." << endl;
 
   cout << "RMSE on the training set: "
       << sqrt(mean(pow(usagePreds - usages, 2))) << "." << std::endl;
 
-  // Now print predictions for the next 24 hours.
+  // Now print predictions for the next 24 hours.  The models predict mean
+  // power over each step, so scale by the step length to get energy.
   cout << endl << "Predictions for the next 24 hours:" << endl;
   for (size_t i = 0; i < genTestTimes.n_elem; ++i)
   {
     time_t t = genTestTimes[i];
     cout << put_time(localtime(&t), "%c %Z") << ": "
-        << genTestPreds[i] << " Wh generated, "
-        << usageTestPreds[i] << " Wh used." << endl;
+        << stepHours * genTestPreds[i] << " Wh generated, "
+        << stepHours * usageTestPreds[i] << " Wh used." << endl;
   }
   cout << endl;
 
@@ -318,8 +463,8 @@ int main()
     {
       // These are the hours that Georgia Power charges more for, where we are
       // interested in tracking the generation.
-      surplus[i] = (i > 0 ? surplus[i - 1] : 0.0) + genTestPreds[i] -
-          usageTestPreds[i];
+      surplus[i] = (i > 0 ? surplus[i - 1] : 0.0) +
+          stepHours * (genTestPreds[i] - usageTestPreds[i]);
       if (surplus[i] >= maxCapacity)
         surplus[i] = maxCapacity;
     }
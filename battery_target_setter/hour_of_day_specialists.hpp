@@ -0,0 +1,198 @@
+/**
+ * @file hour_of_day_specialists.hpp
+ *
+ * A model that splits the day into fixed blocks of hours (local time) and holds
+ * a separate sub-model for each block, so that no single model has to learn the
+ * whole diurnal shape.  The sub-models are independent, so they are trained
+ * concurrently.
+ */
+#ifndef HOUR_OF_DAY_SPECIALISTS_HPP
+#define HOUR_OF_DAY_SPECIALISTS_HPP
+
+#include <algorithm>
+#include <armadillo>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel_for.hpp"
+#include "tree_ensemble.hpp"
+
+template<typename ModelType = TreeEnsemble>
+class HourOfDaySpecialists
+{
+ public:
+  /**
+   * Create an untrained model with one sub-model for each block of
+   * `hoursPerBlock` hours; this must divide 24, and 24 gives a single model for
+   * the whole day.  Each sub-model starts as a copy of `baseModel`, which must
+   * provide a mutable NumThreads().  Training uses at most `numThreads` threads
+   * (0 means use every core), split evenly between the blocks that have data.
+   */
+  HourOfDaySpecialists(const size_t hoursPerBlock = 24,
+                       const ModelType& baseModel = ModelType(),
+                       const size_t numThreads = 0) :
+      hoursPerBlock(hoursPerBlock),
+      baseModel(baseModel),
+      numThreads(numThreads)
+  {
+    if (hoursPerBlock == 0 || 24 % hoursPerBlock != 0)
+    {
+      throw std::invalid_argument("HourOfDaySpecialists: hours per block must "
+          "divide 24!");
+    }
+  }
+
+  /**
+   * Train the sub-models on the given data (one point per column), responses,
+   * and timestamps of each point.  The points are partitioned by block in one
+   * pass over the timestamps, and then all sub-models are trained concurrently.
+   * The threads are shared out between the sub-models, so that every core is
+   * used even when there are fewer blocks than cores.
+   */
+  template<typename MatType, typename ResponsesType>
+  void Train(const MatType& data,
+             const ResponsesType& responses,
+             const arma::uvec& timestamps)
+  {
+    models.assign(NumBlocks(), baseModel);
+    trained.assign(NumBlocks(), false);
+    const size_t threads = ResolveNumThreads(numThreads);
+
+    // No need to copy anything if there is only one block.
+    if (NumBlocks() == 1)
+    {
+      models[0].NumThreads() = threads;
+      models[0].Train(data, responses);
+      trained[0] = true;
+      return;
+    }
+
+    const std::vector<arma::uvec> partitions = Partition(timestamps);
+    size_t trainedBlocks = 0;
+    for (size_t b = 0; b < NumBlocks(); ++b)
+      trainedBlocks += (partitions[b].n_elem > 0) ? 1 : 0;
+    if (trainedBlocks == 0)
+      throw std::invalid_argument("HourOfDaySpecialists::Train(): no data!");
+
+    // Split the threads as evenly as possible between the blocks with data; the
+    // first `threads % trainedBlocks` of them get one extra, so that no core is
+    // left idle.
+    std::vector<size_t> blockThreads(NumBlocks(), 0);
+    for (size_t b = 0, k = 0; b < NumBlocks(); ++b)
+    {
+      if (partitions[b].n_elem == 0)
+        continue;
+
+      blockThreads[b] = std::max<size_t>(1, threads / trainedBlocks +
+          ((k++ < threads % trainedBlocks) ? 1 : 0));
+    }
+
+    ParallelFor(NumBlocks(), std::min(threads, trainedBlocks),
+        [&](const size_t b)
+    {
+      if (partitions[b].n_elem == 0)
+        return;
+
+      const arma::Mat<typename MatType::elem_type> blockData =
+          data.cols(partitions[b]);
+      const arma::Row<typename ResponsesType::elem_type> blockResponses =
+          responses.cols(partitions[b]);
+      models[b].NumThreads() = blockThreads[b];
+      models[b].Train(blockData, blockResponses);
+      trained[b] = true;
+    });
+  }
+
+  /**
+   * Predict the responses for the given points, sending each point to the
+   * sub-model for the block its timestamp falls in.  If that block had no
+   * training data, the nearest block (in time of day) that did is used.
+   */
+  template<typename MatType, typename eT>
+  void Predict(const MatType& data,
+               const arma::uvec& timestamps,
+               arma::Row<eT>& predictions) const
+  {
+    if (models.empty())
+    {
+      throw std::runtime_error("HourOfDaySpecialists::Predict(): model not "
+          "trained!");
+    }
+
+    if (NumBlocks() == 1)
+    {
+      models[0].Predict(data, predictions);
+      return;
+    }
+
+    predictions.set_size(data.n_cols);
+    const std::vector<arma::uvec> partitions = Partition(timestamps);
+    for (size_t b = 0; b < NumBlocks(); ++b)
+    {
+      if (partitions[b].n_elem == 0)
+        continue;
+
+      const arma::Mat<typename MatType::elem_type> blockData =
+          data.cols(partitions[b]);
+      arma::Row<eT> blockPredictions;
+      models[NearestTrainedBlock(b)].Predict(blockData, blockPredictions);
+      predictions.cols(partitions[b]) = blockPredictions;
+    }
+  }
+
+  //! Get the number of blocks (and sub-models).
+  size_t NumBlocks() const { return 24 / hoursPerBlock; }
+
+ private:
+  // Return the indices of the points that fall in each block.
+  std::vector<arma::uvec> Partition(const arma::uvec& timestamps) const
+  {
+    // Count first so each partition is allocated exactly once.
+    arma::uvec blocks(timestamps.n_elem);
+    std::vector<size_t> counts(NumBlocks(), 0);
+    for (size_t i = 0; i < timestamps.n_elem; ++i)
+    {
+      const time_t t = timestamps[i];
+      blocks[i] = localtime(&t)->tm_hour / hoursPerBlock;
+      ++counts[blocks[i]];
+    }
+
+    std::vector<arma::uvec> partitions(NumBlocks());
+    for (size_t b = 0; b < NumBlocks(); ++b)
+      partitions[b].set_size(counts[b]);
+
+    std::vector<size_t> filled(NumBlocks(), 0);
+    for (size_t i = 0; i < blocks.n_elem; ++i)
+      partitions[blocks[i]][filled[blocks[i]]++] = i;
+
+    return partitions;
+  }
+
+  // Return the closest block to `b` (wrapping around midnight) that has a
+  // trained model.
+  size_t NearestTrainedBlock(const size_t b) const
+  {
+    for (size_t d = 0; d <= NumBlocks() / 2; ++d)
+    {
+      if (trained[(b + d) % NumBlocks()])
+        return (b + d) % NumBlocks();
+      if (trained[(b + NumBlocks() - d) % NumBlocks()])
+        return (b + NumBlocks() - d) % NumBlocks();
+    }
+
+    // Train() guarantees at least one block is trained.
+    return b;
+  }
+
+  size_t hoursPerBlock;
+  ModelType baseModel;
+  size_t numThreads;
+
+  std::vector<ModelType> models;
+  // Whether each block had any training data.  (Not std::vector<bool>, since
+  // different threads set different elements.)
+  std::vector<char> trained;
+};
+
+#endif
@@ -159,4 +159,125 @@ InfluxDataset<eT> InnerJoin(const InfluxDataset<eT>& d1,
   return InnerJoin(InnerJoin(d1, d2), InnerJoin(d3, d4));
 }
 
+// Return the native step size (in seconds) of a dataset, taken as the smallest
+// gap between consecutive timestamps.
+template<typename eT>
+size_t NativeStep(const InfluxDataset<eT>& d)
+{
+  if (d.timestamps.n_elem < 2)
+    throw std::runtime_error("Cannot determine step size of a dataset with "
+        "fewer than 2 points!");
+
+  return arma::min(arma::diff(d.timestamps));
+}
+
+/**
+ * Resample a dataset with native step `sourceStep` (in seconds) onto a grid of
+ * `step` seconds; the larger of the two must be a multiple of the smaller.
+ * Each point with timestamp t is taken to describe the interval from t to t
+ * plus its step (`sourceStep` for the input, `step` for the output).
+ *
+ * When upsampling, each output value is linearly interpolated between the
+ * midpoints of the source intervals on either side of the output interval's
+ * midpoint, so that a value describing the middle of its interval (like the sun
+ * position) lands at the right time.  Output intervals in the first or last
+ * half of a source interval next to a gap (or the end of the data) hold the
+ * source value.
+ *
+ * When downsampling, each output value is the mean of the source points in its
+ * interval, and only intervals with no missing source points are kept.
+ *
+ * If step == sourceStep, the dataset is returned unchanged.
+ */
+template<typename eT>
+InfluxDataset<eT> Resample(const InfluxDataset<eT>& d,
+                           const size_t step,
+                           const size_t sourceStep)
+{
+  if (step == sourceStep)
+    return d;
+
+  if ((step < sourceStep && sourceStep % step != 0) ||
+      (step > sourceStep && step % sourceStep != 0))
+  {
+    std::ostringstream oss;
+    oss << "Cannot resample data with step " << sourceStep << "s to step "
+        << step << "s; one must be a multiple of the other!";
+    throw std::runtime_error(oss.str());
+  }
+
+  InfluxDataset<eT> out;
+  out.names = d.names;
+  out.colmap = d.colmap;
+
+  const size_t n = d.timestamps.n_elem;
+  std::vector<size_t> times;
+  std::vector<arma::Col<eT>> cols;
+
+  if (step < sourceStep)
+  {
+    times.reserve(n * (sourceStep / step));
+    cols.reserve(n * (sourceStep / step));
+    for (size_t j = 0; j < n; ++j)
+    {
+      const bool hasPrev = (j > 0 &&
+          d.timestamps[j] - d.timestamps[j - 1] == sourceStep);
+      const bool hasNext = (j + 1 < n &&
+          d.timestamps[j + 1] - d.timestamps[j] == sourceStep);
+
+      for (size_t t = d.timestamps[j]; t < d.timestamps[j] + sourceStep;
+           t += step)
+      {
+        // Offset of the output interval's midpoint from the source interval's
+        // midpoint, as a fraction of the source step.
+        const eT w = (eT(2 * (t - d.timestamps[j]) + step) - eT(sourceStep)) /
+            eT(2 * sourceStep);
+
+        times.push_back(t);
+        if (w >= 0 && hasNext)
+          cols.push_back((1 - w) * d.data.col(j) + w * d.data.col(j + 1));
+        else if (w < 0 && hasPrev)
+          cols.push_back((1 + w) * d.data.col(j) - w * d.data.col(j - 1));
+        else
+          cols.push_back(d.data.col(j));
+      }
+    }
+  }
+  else
+  {
+    const size_t pointsPerStep = step / sourceStep;
+    times.reserve(n / pointsPerStep + 1);
+    cols.reserve(n / pointsPerStep + 1);
+    size_t j = 0;
+    while (j < n)
+    {
+      // Collect every source point in the output interval containing point j.
+      const size_t t = d.timestamps[j] - (d.timestamps[j] % step);
+      arma::Col<eT> sum(d.data.n_rows, arma::fill::zeros);
+      size_t count = 0;
+      for (; j < n && d.timestamps[j] < t + step; ++j)
+      {
+        sum += d.data.col(j);
+        ++count;
+      }
+
+      if (count == pointsPerStep)
+      {
+        times.push_back(t);
+        cols.push_back(sum / eT(count));
+      }
+    }
+  }
+
+  out.timestamps.set_size(times.size());
+  out.data.set_size(d.data.n_rows, times.size());
+  for (size_t i = 0; i < times.size(); ++i)
+  {
+    out.timestamps[i] = times[i];
+    out.data.col(i) = cols[i];
+  }
+
+  return out;
+}
+
 #endif
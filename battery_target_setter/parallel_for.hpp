@@ -0,0 +1,83 @@
+/**
+ * @file parallel_for.hpp
+ *
+ * A minimal fixed-size thread pool: run a function on every index in [0, n)
+ * using at most a given number of threads.  Each worker pulls the next index
+ * off a shared counter, so uneven tasks (e.g. trees of different depths) still
+ * keep all the cores busy.
+ */
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Return the number of threads to use if the user asked for `numThreads`; 0
+ * means "use every core".
+ */
+inline size_t ResolveNumThreads(const size_t numThreads)
+{
+  if (numThreads != 0)
+    return numThreads;
+
+  const size_t hw = std::thread::hardware_concurrency();
+  return (hw == 0) ? 1 : hw;
+}
+
+/**
+ * Call `f(i)` for each i in [0, n), using at most `numThreads` threads (0 means
+ * use every core).  If any call throws, the first exception is rethrown on the
+ * calling thread once all workers have finished.
+ */
+template<typename FunctionType>
+void ParallelFor(const size_t n, const size_t numThreads, FunctionType f)
+{
+  const size_t threads = std::min(ResolveNumThreads(numThreads), n);
+  if (threads <= 1)
+  {
+    for (size_t i = 0; i < n; ++i)
+      f(i);
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+
+  auto worker = [&]()
+  {
+    for (size_t i = next++; i < n; i = next++)
+    {
+      try
+      {
+        f(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+  };
+
+  // The calling thread does its share of the work too.
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (size_t t = 0; t < threads - 1; ++t)
+    pool.emplace_back(worker);
+  worker();
+
+  for (std::thread& t : pool)
+    t.join();
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+#endif
@@ -1,7 +1,8 @@
 /**
  * @file print_dataset.hpp
  *
- * Utility to print the last 24 hours of a dataset in a nice way.
+ * Utility to print the last day (or any number of points) of a dataset in a
+ * nice way.
  */
 #ifndef PRINT_DATASET_HPP
 #define PRINT_DATASET_HPP
@@ -9,11 +10,13 @@
 #include <iomanip>
 #include "influx_tools.hpp"
 
+// Print the last `numPoints` points of the dataset, labeled by local time.
 template<typename eT>
-void PrintDataset(const InfluxDataset<eT>& d)
+void PrintDataset(const InfluxDataset<eT>& d, const size_t numPoints = 24)
 {
   setenv("TZ", "/usr/share/zoneinfo/America/New_York", 1);
-  std::time_t t = d.timestamps[d.timestamps.n_elem - 24];
+  const size_t first = d.timestamps.n_elem - numPoints;
+  std::time_t t = d.timestamps[first];
   std::cout << "Start time of data snippet: "
       << std::put_time(std::localtime(&t), "%c %Z") << "." << std::endl;
 
@@ -25,8 +28,11 @@ void PrintDataset(const InfluxDataset<eT>& d)
 
   // Print the header row.
   std::cout << std::setw(maxChars + 3) << std::setfill(' ') << "";
-  for (size_t i = 0; i < 24; ++i)
-    std::cout << std::setw(8) << i << "  ";
+  for (size_t c = first; c < d.timestamps.n_elem; ++c)
+  {
+    std::time_t ct = d.timestamps[c];
+    std::cout << "   " << std::put_time(std::localtime(&ct), "%H:%M") << "  ";
+  }
   std::cout << std::endl;
 
   for (size_t r = 0; r < d.names.size(); ++r)
@@ -34,7 +40,7 @@ void PrintDataset(const InfluxDataset<eT>& d)
     std::cout << std::setw(maxChars) << std::setfill(' ') << d.names[r]
         << "   ";
 
-    for (size_t c = d.timestamps.n_elem - 24; c < d.timestamps.n_elem; ++c)
+    for (size_t c = first; c < d.timestamps.n_elem; ++c)
     {
       if (std::abs(d.data(r, c)) >= 1000)
       {
@@ -0,0 +1,141 @@
+/**
+ * @file tree_ensemble.hpp
+ *
+ * A random forest of regression trees, with the trees trained in parallel.
+ * Each tree is trained on a bootstrap sample of the training set.  Only the
+ * distinct points drawn (about 63% of them) are copied, and the number of
+ * times each was drawn is passed to the tree as its instance weight.  Each
+ * split only considers a random third of the dimensions.
+ */
+#ifndef TREE_ENSEMBLE_HPP
+#define TREE_ENSEMBLE_HPP
+
+#include <mlpack.hpp>
+#include <random>
+#include <vector>
+
+#include "parallel_for.hpp"
+
+class TreeEnsemble
+{
+ public:
+  //! The type of each tree: a regression tree that picks a random subset of
+  //! dimensions to consider at each split.
+  typedef mlpack::DecisionTreeRegressor<mlpack::MSEGain,
+                                        mlpack::BestBinaryNumericSplit,
+                                        mlpack::AllCategoricalSplit,
+                                        mlpack::MultipleRandomDimensionSelect>
+      TreeType;
+
+  //! The smallest number of trees used when the tree count is left to the
+  //! default.  Each tree searches a third of the dimensions at each split, so it
+  //! costs roughly a third of an unrestricted tree; this many trees on one core
+  //! is then still within about 3x of the single-tree baseline, while giving
+  //! enough trees to average over.
+  static constexpr size_t minimumDefaultTrees = 8;
+
+  /**
+   * Create an untrained ensemble of `numTrees` trees (0 means the larger of
+   * `minimumDefaultTrees` and the number of training threads at construction
+   * time).  Training uses at most `numThreads` threads (0 means use every
+   * core).  `seed` controls the bootstrap samples; tree i always gets the same
+   * sample for a given seed, no matter which thread trains it.
+   */
+  TreeEnsemble(const size_t numTrees = 0,
+               const size_t numThreads = 0,
+               const size_t minimumLeafSize = 10,
+               const size_t seed = 0) :
+      numTrees((numTrees == 0) ? std::max(minimumDefaultTrees,
+          ResolveNumThreads(numThreads)) : numTrees),
+      numThreads(numThreads),
+      minimumLeafSize(minimumLeafSize),
+      seed(seed)
+  { }
+
+  /**
+   * Train the ensemble on the given data (one point per column) and responses.
+   *
+   * Each worker thread holds one bootstrap sample (about 63% of the columns of
+   * `data`) while it trains a tree, so peak memory is about 0.63 times the
+   * number of threads times the size of the dataset; it does not grow with the
+   * number of trees beyond the trees themselves.
+   */
+  template<typename MatType, typename ResponsesType>
+  void Train(const MatType& data, const ResponsesType& responses)
+  {
+    if (data.n_cols == 0)
+      throw std::invalid_argument("TreeEnsemble::Train(): empty dataset!");
+
+    // A third of the dimensions is the usual choice for regression forests.
+    const size_t splitDimensions = std::max<size_t>(1, data.n_rows / 3);
+
+    trees.clear();
+    trees.resize(numTrees);
+
+    ParallelFor(trees.size(), numThreads, [&](const size_t t)
+    {
+      std::mt19937 rng(seed + t);
+      std::uniform_int_distribution<size_t> dist(0, data.n_cols - 1);
+
+      // A bootstrap sample is data.n_cols draws with replacement; a point's
+      // weight is the number of times it was drawn.
+      arma::rowvec counts(data.n_cols, arma::fill::zeros);
+      for (size_t i = 0; i < data.n_cols; ++i)
+        counts[dist(rng)] += 1.0;
+
+      // mlpack takes the training data by value anyway, so give it only the
+      // points that were drawn, and move them in to avoid a second copy.
+      const arma::uvec drawn = arma::find(counts > 0);
+      arma::Mat<typename MatType::elem_type> sample = data.cols(drawn);
+      arma::Row<typename ResponsesType::elem_type> sampleResponses =
+          responses.cols(drawn);
+      arma::rowvec sampleWeights = counts.cols(drawn);
+
+      // The random dimension selection draws from mlpack's RNG, which is
+      // thread-local, so each worker is seeded separately.
+      mlpack::RandomSeed(seed + t);
+      trees[t].Train(std::move(sample), std::move(sampleResponses),
+          std::move(sampleWeights), minimumLeafSize, 1e-7, 0,
+          mlpack::MultipleRandomDimensionSelect(splitDimensions));
+    });
+  }
+
+  /**
+   * Predict the responses for the given points as the mean prediction of all
+   * trees.
+   */
+  template<typename MatType, typename eT>
+  void Predict(const MatType& data, arma::Row<eT>& predictions) const
+  {
+    if (trees.empty())
+      throw std::runtime_error("TreeEnsemble::Predict(): model not trained!");
+
+    predictions.zeros(data.n_cols);
+    arma::Row<eT> treePredictions;
+    for (const TreeType& tree : trees)
+    {
+      tree.Predict(data, treePredictions);
+      predictions += treePredictions;
+    }
+    predictions /= trees.size();
+  }
+
+  //! Get the number of trees in the ensemble.
+  size_t NumTrees() const { return numTrees; }
+
+  //! Get the maximum number of threads used for training (0 means all cores).
+  size_t NumThreads() const { return numThreads; }
+  //! Modify the maximum number of threads used for training.  This does not
+  //! change the number of trees.
+  size_t& NumThreads() { return numThreads; }
+
+ private:
+  size_t numTrees;
+  size_t numThreads;
+  size_t minimumLeafSize;
+  size_t seed;
+
+  std::vector<TreeType> trees;
+};
+
+#endif
@@ -8,14 +8,21 @@ from influxdb_client.client.write_api import SYNCHRONOUS
 
 LATITUDE = 33.78317
 LONGITUDE = -84.40153
+# Step size of the generated data, in minutes.  Hourly data goes in the
+# "sun_altaz" measurement, and any sub-hourly step goes in "sun_altaz_15m",
+# which is what battery_target_setter reads with `--step-minutes 15` or 30 (it
+# resamples whatever step it finds there).  The default of 60 only produces
+# hourly data: before using 15-minute mode, set this to 15 and rerun this
+# script.
+STEP_MINUTES = 60
 
 def compute_sun_altaz(t, lat, lon):
   """
   Compute the altitude and azimuth of the sun at the given Earth coordinates and
-  30 minutes from the given time.  For our modeling purposes, we want the sun's
-  coordinates halfway through the hour.
+  half a step from the given time.  For our modeling purposes, we want the sun's
+  coordinates halfway through the step.
   """
-  s = get_sun(Time(t) + TimeDelta(1800, format='sec'))
+  s = get_sun(Time(t) + TimeDelta(STEP_MINUTES * 30, format='sec'))
   e = EarthLocation(lat=(lat * u.deg), lon=(lon * u.deg))
   altaz = s.transform_to(AltAz(obstime=t, location=e))
   return (altaz.alt.degree, altaz.az.degree)
@@ -23,7 +30,7 @@ def compute_sun_altaz(t, lat, lon):
 
 df = pd.DataFrame({ 'time': pd.date_range(start='2025-08-01',
                                           end='2030-05-01',
-                                          freq='h',
+                                          freq=f'{STEP_MINUTES}min',
                                           tz='America/New_York') })
 
 print(df)
@@ -43,4 +50,5 @@ write_client = client.write_api(write_options=SYNCHRONOUS)
 write_client.write("weather",
                    "my-org",
                    record=df,
-                   data_frame_measurement_name="sun_altaz")
+                   data_frame_measurement_name=("sun_altaz" if STEP_MINUTES >= 60
+                       else "sun_altaz_15m"))
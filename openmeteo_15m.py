@@ -0,0 +1,78 @@
+# openmeteo_15m.py
+#
+# Shared helper for the Open-Meteo pull scripts: pull the variables that
+# Open-Meteo offers at 15-minute resolution and write them to a "_15m"
+# measurement (e.g. "daily_forecast_15m"), which battery_target_setter reads in
+# `--step-minutes 15` (or 30) mode.  Variables without 15-minute data are filled
+# in from the hourly data that the calling script already wrote.
+#
+# This is a separate API call that runs after the hourly data has been written,
+# so a failure here never affects the hourly measurements.
+from datetime import datetime
+import pandas as pd
+from influxdb_client.client.write_api import SYNCHRONOUS
+
+MINUTELY_15_VARIABLES = ["temperature_2m",
+                         "shortwave_radiation",
+                         "direct_radiation",
+                         "diffuse_radiation",
+                         "direct_normal_irradiance",
+                         "terrestrial_radiation",
+                         "global_tilted_irradiance",
+                         "wind_speed_10m",
+                         "wind_gusts_10m",
+                         "relative_humidity_2m",
+                         "dew_point_2m",
+                         "apparent_temperature",
+                         "precipitation",
+                         "cape",
+                         "rain",
+                         "showers",
+                         "snowfall",
+                         "visibility"]
+
+def pull_minutely_15(openmeteo, url, params, hourly_dataframe, client,
+                     measurement, clear=False):
+  """
+  Request the 15-minute variables with the same location, dates, and model as
+  `params` (the hourly request), combine them with `hourly_dataframe`, and write
+  the result to `measurement` + "_15m".  If `clear` is set, the measurement is
+  emptied first.
+  """
+  params_15m = { k: v for k, v in params.items() if k != "hourly" }
+  params_15m["minutely_15"] = MINUTELY_15_VARIABLES
+  response = openmeteo.weather_api(url, params=params_15m)[0]
+
+  minutely_15 = response.Minutely15()
+  minutely_15_data = {"date": pd.date_range(
+    start = pd.to_datetime(minutely_15.Time(), unit = "s", utc = True),
+    end =  pd.to_datetime(minutely_15.TimeEnd(), unit = "s", utc = True),
+    freq = pd.Timedelta(seconds = minutely_15.Interval()),
+    inclusive = "left"
+  )}
+  for i, v in enumerate(MINUTELY_15_VARIABLES):
+    minutely_15_data[v] = minutely_15.Variables(i).ValuesAsNumpy()
+  minutely_15_dataframe = pd.DataFrame(data = minutely_15_data)
+  minutely_15_dataframe = minutely_15_dataframe.set_index("date")
+
+  # Many hourly values (e.g. radiation) describe the hour *before* their
+  # timestamp, so each one is carried back over the 15-minute points in that
+  # hour; the points after the last hour hold its value.  Then the variables
+  # that have real 15-minute data overwrite the hourly values.
+  combined = hourly_dataframe.reindex(minutely_15_dataframe.index,
+                                      method = "bfill").ffill()
+  combined[MINUTELY_15_VARIABLES] = minutely_15_dataframe
+  print("\n15-minute data\n", combined)
+
+  if clear:
+    client.delete_api().delete("1970-01-01T00:00:00Z",
+        datetime.now().isoformat(timespec='seconds') + "Z",
+        f'_measurement="{measurement}_15m"',
+        bucket="weather",
+        org="my-org")
+
+  write_client = client.write_api(write_options=SYNCHRONOUS)
+  write_client.write("weather",
+                     "my-org",
+                     record=combined,
+                     data_frame_measurement_name=f"{measurement}_15m")
@@ -4,6 +4,7 @@ import requests_cache
 from retry_requests import retry
 import influxdb_client
 from influxdb_client.client.write_api import SYNCHRONOUS
+import openmeteo_15m
 from datetime import datetime, timedelta
 
 # Setup the Open-Meteo API client with cache and retry on error
@@ -11,6 +12,10 @@ cache_session = requests_cache.CachedSession('.cache', expire_after = 3600)
 retry_session = retry(cache_session, retries = 5, backoff_factor = 0.2)
 openmeteo = openmeteo_requests.Client(session = retry_session)
 
+# Set this to also pull Open-Meteo's 15-minute data (see openmeteo_15m.py) for
+# battery_target_setter's `--step-minutes 15` mode.
+PULL_15_MINUTE = False
+
 # Make sure all required weather variables are listed here
 # The order of variables in hourly or daily is important to assign them
 # correctly below
@@ -146,3 +151,8 @@ write_client.write("weather",
                    "my-org",
                    record=hourly_dataframe,
                    data_frame_measurement_name="daily_forecast")
+
+# The hourly data is written, so now optionally pull the 15-minute data.
+if PULL_15_MINUTE:
+  openmeteo_15m.pull_minutely_15(openmeteo, url, params, hourly_dataframe,
+                                 client, "daily_forecast", clear=True)
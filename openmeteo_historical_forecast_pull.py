@@ -5,12 +5,17 @@ from retry_requests import retry
 from datetime import datetime, timedelta
 import influxdb_client
 from influxdb_client.client.write_api import SYNCHRONOUS
+import openmeteo_15m
 
 # Setup the Open-Meteo API client with cache and retry on error
 cache_session = requests_cache.CachedSession('.cache', expire_after = 3600)
 retry_session = retry(cache_session, retries = 5, backoff_factor = 0.2)
 openmeteo = openmeteo_requests.Client(session = retry_session)
 
+# Set this to also pull Open-Meteo's 15-minute data (see openmeteo_15m.py) for
+# battery_target_setter's `--step-minutes 15` mode.
+PULL_15_MINUTE = False
+
 # Get yesterday's data (this is expected to run via cron every day at ~4am).
 start_date = datetime.today() - timedelta(days=1)
 start_date_str = start_date.strftime("%Y-%m-%d")
@@ -142,3 +147,8 @@ write_client.write("weather",
                    "my-org",
                    record=hourly_dataframe,
                    data_frame_measurement_name="forecast_history")
+
+# The hourly data is written, so now optionally pull the 15-minute data.
+if PULL_15_MINUTE:
+  openmeteo_15m.pull_minutely_15(openmeteo, url, params, hourly_dataframe,
+                                 client, "forecast_history")